@@ -1,5 +1,7 @@
 #include <atomicassets.hpp>
+#include <atomicdata.hpp>
 #include <eosio/asset.hpp>
+#include <eosio/binary_extension.hpp>
 #include <eosio/eosio.hpp>
 #include <eosio/permission.hpp>
 #include <eosio/singleton.hpp>
@@ -11,6 +13,9 @@ using namespace std;
 CONTRACT alienrumblex : public contract {
     static constexpr eosio::symbol TLM_SYMBOL = symbol("TLM", 4);
     static constexpr eosio::name TLM_CONTRACT = name("alien.worlds");
+    static constexpr eosio::name AW_COLLECTION = name("alien.worlds");
+    static constexpr eosio::name CREW_SCHEMA = name("crew.worlds");
+    static constexpr eosio::name ARMS_SCHEMA = name("arms.worlds");
 
   public:
     using contract::contract;
@@ -22,9 +27,15 @@ CONTRACT alienrumblex : public contract {
                       const uint8_t &attack, const uint8_t &defense);
     ACTION setarena(const name &arena_name, const asset &cost, const uint8_t &fee);
     ACTION rmarena(const name &arena_name);
+    ACTION rebuildconf();
     ACTION startbattle(const name &arena_name);
     ACTION logwinner(const uint64_t &battle_id, const name &winner);
+    ACTION setautopay(const bool &enabled);
+    ACTION payout(const uint64_t &max_rows);
+    ACTION creditpay(const name &account);
     ACTION fullreset();
+    ACTION migrateaccs(const uint64_t &max_rows);
+    ACTION migrateseq(const name &table, const uint64_t &lower_bound, const uint64_t &max_rows);
 
     // user actions
     ACTION regnewuser(const name &user);
@@ -36,7 +47,8 @@ CONTRACT alienrumblex : public contract {
     void receive_tokens(name from, name to, asset quantity, string memo);
 
   private:
-    // accounts table data struct
+    // legacy accounts table data struct
+    // replaced by the balances & stats tables, kept for the migration
     TABLE account_entity {
         name account;
         extended_asset balance;
@@ -48,15 +60,70 @@ CONTRACT alienrumblex : public contract {
         }
     };
 
+    // balances data struct
+    // fixed size row holding the frequently written balance data
+    TABLE balance_entity {
+        name account;
+        asset balance;
+        asset reserved;
+
+        auto primary_key() const {
+            return account.value;
+        }
+    };
+
+    // stats data struct
+    // only written when a battle is resolved
+    TABLE stats_entity {
+        name account;
+        uint64_t battle_count;
+        uint64_t win_count;
+
+        auto primary_key() const {
+            return account.value;
+        }
+    };
+
+    // settings data struct
+    TABLE settings_entity {
+        bool auto_payout = false;
+    };
+
+    // payout ledger data struct
+    TABLE payout_entity {
+        name account;
+        asset quantity;
+        uint64_t win_count;
+        time_point_sec since;
+
+        auto primary_key() const {
+            return account.value;
+        }
+    };
+
+    // change feed head data struct
+    TABLE head_entity {
+        uint64_t seq = 0;
+        uint64_t arenas_seq = 0;
+        uint64_t queues_seq = 0;
+        uint64_t battles_seq = 0;
+        uint64_t reset_seq = 0;
+    };
+
     // arena data struct
     TABLE arena_entity {
         name name;
         extended_asset cost;
         uint8_t fee;
+        binary_extension<uint64_t> seq;
 
         auto primary_key() const {
             return name.value;
         }
+
+        uint64_t seq_key() const {
+            return seq.value_or(0);
+        }
     };
 
     // weaponconf data struct
@@ -84,6 +151,49 @@ CONTRACT alienrumblex : public contract {
         }
     };
 
+    // stats decoded from an alien worlds template, element is the crew
+    // element or the weapon class
+    struct template_stats {
+        string element;
+        uint8_t attack;
+        uint8_t defense;
+    };
+
+    // resolved battle stats of a crew/weapon
+    struct unit_stats {
+        string element;
+        uint16_t power;
+    };
+
+    // config snapshot crew/weapon entry struct
+    struct conf_entry {
+        uint64_t template_id;
+        uint8_t element;
+        uint16_t power;
+    };
+
+    // config snapshot arena entry struct
+    struct arena_conf_entry {
+        name arena_name;
+        asset cost;
+        uint8_t fee;
+    };
+
+    // config snapshot data struct
+    // crews, weapons & arenas are sorted by their key for binary search,
+    // element is the index of the crew element/weapon class in elements,
+    // templates & invalid_templates cache the decoded alien worlds templates
+    // with & without battle attributes
+    TABLE conf_snapshot_entity {
+        uint64_t version = 0;
+        vector<string> elements;
+        vector<conf_entry> crews;
+        vector<conf_entry> weapons;
+        vector<arena_conf_entry> arenas;
+        vector<conf_entry> templates;
+        vector<uint64_t> invalid_templates;
+    };
+
     // queue entry data struct
     struct queue_entry {
         name arena_name;
@@ -92,13 +202,20 @@ CONTRACT alienrumblex : public contract {
     };
 
     // queue data struct
+    // reservations holds the arena cost reserved by each entry of queues
     TABLE queue_entity {
         name player;
         vector<queue_entry> queues;
+        binary_extension<uint64_t> seq;
+        binary_extension<vector<asset>> reservations;
 
         auto primary_key() const {
             return player.value;
         }
+
+        uint64_t seq_key() const {
+            return seq.value_or(0);
+        }
     };
 
     // battle data struct
@@ -108,6 +225,7 @@ CONTRACT alienrumblex : public contract {
         vector<name> players;
         name winner;
         time_point_sec timestamp;
+        binary_extension<uint64_t> seq;
 
         auto primary_key() const {
             return battle_id;
@@ -120,29 +238,75 @@ CONTRACT alienrumblex : public contract {
         uint64_t tertiary_key() const {
             return winner.value;
         }
+
+        uint64_t seq_key() const {
+            return seq.value_or(0);
+        }
     };
 
     typedef multi_index<name("accounts"), account_entity> accounts_table;
+    typedef multi_index<name("balances"), balance_entity> balances_table;
+    typedef multi_index<name("stats"), stats_entity> stats_table;
+    typedef multi_index<name("payouts"), payout_entity> payouts_table;
     typedef multi_index<name("weaponconf"), weapon_conf_entity> weapons_conf_table;
     typedef multi_index<name("crewconf"), crew_conf_entity> crews_conf_table;
-    typedef multi_index<name("arenas"), arena_entity> arenas_table;
-    typedef multi_index<name("queues"), queue_entity> queues_table;
+    typedef singleton<name("settings"), settings_entity> settings_singleton;
+    typedef singleton<name("head"), head_entity> head_singleton;
+    typedef singleton<name("confsnap"), conf_snapshot_entity> conf_snapshot_singleton;
+    typedef multi_index<
+        name("arenas"), arena_entity,
+        indexed_by<name("seq"), const_mem_fun<arena_entity, uint64_t, &arena_entity::seq_key>>>
+        arenas_table;
+    typedef multi_index<
+        name("queues"), queue_entity,
+        indexed_by<name("seq"), const_mem_fun<queue_entity, uint64_t, &queue_entity::seq_key>>>
+        queues_table;
     typedef multi_index<
         name("battles"), battle_entity,
         indexed_by<name("arena"),
                    const_mem_fun<battle_entity, uint64_t, &battle_entity::secondary_key>>,
         indexed_by<name("winner"),
-                   const_mem_fun<battle_entity, uint64_t, &battle_entity::tertiary_key>>>
+                   const_mem_fun<battle_entity, uint64_t, &battle_entity::tertiary_key>>,
+        indexed_by<name("seq"), const_mem_fun<battle_entity, uint64_t, &battle_entity::seq_key>>>
         battles_table;
 
     // helper functions
-    accounts_table::const_iterator check_user_registered(const name &user);
-    void check_user_weapon(const name &user, const uint64_t &asset_id);
-    void check_user_crew(const name &user, const uint64_t &asset_id);
+    balances_table::const_iterator check_user_registered(balances_table &balances,
+                                                         const name &user);
+    accounts_table::const_iterator migrate_account(accounts_table &accounts,
+                                                   accounts_table::const_iterator account);
+    void release_reserved(balances_table &balances, const name &user, const asset &quantity);
+    vector<asset> get_reservations(const queue_entity &queue);
+    void check_user_weapon(const name &user, const uint64_t &asset_id, conf_snapshot_entity &conf);
+    void check_user_crew(const name &user, const uint64_t &asset_id, conf_snapshot_entity &conf);
+    optional<unit_stats> get_unit_stats(conf_snapshot_entity &conf,
+                                        const atomicassets::assets_s &asset,
+                                        const name &schema_name);
+    const conf_entry *cache_template_stats(conf_snapshot_entity &conf,
+                                           const atomicassets::assets_s &asset);
+    optional<template_stats> get_template_stats(const atomicassets::assets_s &asset);
+    const conf_entry *find_conf(const vector<conf_entry> &confs, const uint64_t &template_id);
+    const arena_conf_entry *find_arena_conf(const conf_snapshot_entity &conf,
+                                            const name &arena_name);
+    uint8_t element_index(conf_snapshot_entity &conf, const string &element);
+    void rebuild_conf_snapshot();
     uint64_t tx_rand(const uint64_t &upper_limit);
+    uint64_t next_seq(const name &table, const uint64_t &count = 1);
+    template <typename T, typename F>
+    typename T::const_iterator modify_with_seq(T &rows, typename T::const_iterator itr,
+                                               const uint64_t &seq, F &&updater);
+    template <typename T>
+    void backfill_seq(T &rows, const name &table, const uint64_t &lower_bound,
+                      const uint64_t &max_rows);
 
     // getter functions
+    settings_singleton get_settings();
+    head_singleton get_head();
+    conf_snapshot_entity get_conf_snapshot();
     accounts_table get_accounts();
+    balances_table get_balances();
+    stats_table get_stats();
+    payouts_table get_payouts();
     weapons_conf_table get_weapons_conf();
     crews_conf_table get_crews_conf();
     arenas_table get_arenas();
@@ -4,6 +4,8 @@ It can be used as a header file for other contracts to access the atomicassets
 tables and custom data types.
 */
 
+#pragma once
+
 #include <eosio/eosio.hpp>
 #include <eosio/asset.hpp>
 
@@ -56,9 +58,44 @@ namespace atomicassets {
         };
     };
 
+    // Scope: collection_name
+    struct schemas_s {
+        name schema_name;
+        vector<FORMAT> format;
+
+        uint64_t primary_key() const {
+            return schema_name.value;
+        }
+    };
+
+    // Scope: collection_name
+    struct templates_s {
+        int32_t template_id;
+        name schema_name;
+        bool transferable;
+        bool burnable;
+        uint32_t max_supply;
+        uint32_t issued_supply;
+        vector<uint8_t> immutable_serialized_data;
+
+        uint64_t primary_key() const {
+            return (uint64_t)template_id;
+        }
+    };
+
     typedef multi_index<name("assets"), assets_s> assets_t;
+    typedef multi_index<name("schemas"), schemas_s> schemas_t;
+    typedef multi_index<name("templates"), templates_s> templates_t;
 
     assets_t get_assets(name acc) {
         return assets_t(ATOMICASSETS_ACCOUNT, acc.value);
     }
+
+    schemas_t get_schemas(name collection_name) {
+        return schemas_t(ATOMICASSETS_ACCOUNT, collection_name.value);
+    }
+
+    templates_t get_templates(name collection_name) {
+        return templates_t(ATOMICASSETS_ACCOUNT, collection_name.value);
+    }
 }; // namespace atomicassets
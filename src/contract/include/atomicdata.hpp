@@ -0,0 +1,154 @@
+/*
+Zero-copy reader for the atomicassets attribute serialization.
+Walks the serialized bytes using the schema format and hands out views of
+the requested attributes, without building an ATTRIBUTE_MAP.
+*/
+
+#pragma once
+
+#include <atomicassets.hpp>
+#include <string_view>
+
+using namespace eosio;
+using namespace std;
+
+namespace atomicdata {
+    // attribute identifiers are offset by the number of reserved identifiers
+    static constexpr uint64_t RESERVED = 4;
+
+    // a view of a single serialized attribute value
+    struct attribute_view {
+        const atomicassets::FORMAT *format;
+        const uint8_t *begin;
+        const uint8_t *end;
+    };
+
+    uint64_t read_varint(const uint8_t *&itr, const uint8_t *end) {
+        uint64_t value = 0;
+        uint8_t shift = 0;
+
+        while (true) {
+            check(itr != end, "unexpected end of serialized data");
+            check(shift < 64, "varint is too long");
+
+            uint8_t byte = *itr++;
+            value |= (uint64_t)(byte & 0x7F) << shift;
+            shift += 7;
+
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+    }
+
+    int64_t zigzag_decode(const uint64_t &value) {
+        return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+    }
+
+    uint64_t read_fixed(const uint8_t *&itr, const uint8_t *end, const uint8_t &size) {
+        check(end - itr >= size, "unexpected end of serialized data");
+
+        uint64_t value = 0;
+        for (uint8_t i = 0; i < size; i++) {
+            value |= (uint64_t)(*itr++) << (8 * i);
+        }
+        return value;
+    }
+
+    // byte size of the fixed size types, 0 for variable size types
+    uint8_t fixed_size(const string_view &type) {
+        if (type == "fixed8" || type == "byte" || type == "bool") {
+            return 1;
+        } else if (type == "fixed16") {
+            return 2;
+        } else if (type == "fixed32" || type == "float") {
+            return 4;
+        } else if (type == "fixed64" || type == "double") {
+            return 8;
+        }
+        return 0;
+    }
+
+    bool is_varint(const string_view &type) {
+        return type == "int8" || type == "int16" || type == "int32" || type == "int64" ||
+               type == "uint8" || type == "uint16" || type == "uint32" || type == "uint64";
+    }
+
+    bool is_string(const string_view &type) {
+        return type == "string" || type == "image" || type == "ipfs";
+    }
+
+    // move the iterator past a value of the given type
+    void skip_value(const uint8_t *&itr, const uint8_t *end, const string_view &type) {
+        if (type.size() > 2 && type.substr(type.size() - 2) == "[]") {
+            auto count = read_varint(itr, end);
+            auto base_type = type.substr(0, type.size() - 2);
+            for (uint64_t i = 0; i < count; i++) {
+                skip_value(itr, end, base_type);
+            }
+        } else if (is_varint(type)) {
+            read_varint(itr, end);
+        } else if (is_string(type)) {
+            auto length = read_varint(itr, end);
+            check((uint64_t)(end - itr) >= length, "unexpected end of serialized data");
+            itr += length;
+        } else {
+            auto size = fixed_size(type);
+            check(size > 0, string("unsupported attribute type: " + string(type)).c_str());
+            check(end - itr >= size, "unexpected end of serialized data");
+            itr += size;
+        }
+    }
+
+    /*
+        Call visitor(attribute_view) for every attribute in the serialized data
+
+        @param {vector<uint8_t>} data - the serialized attributes
+        @param {vector<FORMAT>} format - the format of the schema the data belongs to
+    */
+    template <typename Visitor>
+    void for_each_attribute(const vector<uint8_t> &data,
+                            const vector<atomicassets::FORMAT> &format, Visitor &&visitor) {
+        const uint8_t *itr = data.data();
+        const uint8_t *end = itr + data.size();
+
+        while (itr != end) {
+            auto identifier = read_varint(itr, end);
+            check(identifier >= RESERVED && identifier - RESERVED < format.size(),
+                  "invalid attribute identifier");
+
+            const auto &line = format[identifier - RESERVED];
+            auto begin = itr;
+            skip_value(itr, end, line.type);
+
+            visitor(attribute_view{&line, begin, itr});
+        }
+    }
+
+    // read an integer attribute, whatever its integer type is
+    int64_t as_int(const attribute_view &view) {
+        const string &type = view.format->type;
+        const uint8_t *itr = view.begin;
+
+        if (is_varint(type)) {
+            auto value = read_varint(itr, view.end);
+            return type[0] == 'u' ? (int64_t)value : zigzag_decode(value);
+        } else if (type.rfind("fixed", 0) == 0 || type == "byte" || type == "bool") {
+            return read_fixed(itr, view.end, fixed_size(type));
+        }
+
+        check(false, string("attribute " + view.format->name + " is not an integer").c_str());
+        return 0;
+    }
+
+    // read a string attribute, the view points into the serialized data
+    string_view as_string(const attribute_view &view) {
+        check(is_string(view.format->type),
+              string("attribute " + view.format->name + " is not a string").c_str());
+
+        const uint8_t *itr = view.begin;
+        auto length = read_varint(itr, view.end);
+
+        return string_view((const char *)itr, length);
+    }
+}; // namespace atomicdata
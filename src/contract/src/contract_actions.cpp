@@ -24,6 +24,9 @@ ACTION alienrumblex::setweaponcnf(const uint64_t &template_id, const string &wea
             row.defense = defense;
         });
     }
+
+    // keep the config snapshot in sync
+    rebuild_conf_snapshot();
 }
 
 ACTION alienrumblex::setcrewcnf(const uint64_t &template_id, const string &race,
@@ -55,6 +58,9 @@ ACTION alienrumblex::setcrewcnf(const uint64_t &template_id, const string &race,
             row.defense = defense;
         });
     }
+
+    // keep the config snapshot in sync
+    rebuild_conf_snapshot();
 }
 
 ACTION alienrumblex::setarena(const name &arena_name, const asset &cost, const uint8_t &fee) {
@@ -71,21 +77,28 @@ ACTION alienrumblex::setarena(const name &arena_name, const asset &cost, const u
 
     auto arena = arenas.find(arena_name.value);
 
+    // get the change feed sequence number of this change
+    auto seq = next_seq(name("arenas"));
+
     // if there's no arena
     if (arena == arenas.end()) {
         arenas.emplace(get_self(), [&](auto &row) {
             row.name = arena_name;
             row.cost = extended_asset(cost, TLM_CONTRACT);
             row.fee = fee;
+            row.seq.emplace(seq);
         });
     } else {
         // else: modify existing row
-        arenas.modify(arena, same_payer, [&](auto &row) {
+        modify_with_seq(arenas, arena, seq, [&](auto &row) {
             row.name = arena_name;
             row.cost = extended_asset(cost, TLM_CONTRACT);
             row.fee = fee;
         });
     }
+
+    // keep the config snapshot in sync
+    rebuild_conf_snapshot();
 }
 
 ACTION alienrumblex::rmarena(const name &arena_name) {
@@ -100,25 +113,43 @@ ACTION alienrumblex::rmarena(const name &arena_name) {
 
     // delete the arena row
     arenas.erase(arena);
+
+    // bump the change feed, removed rows can only be noticed through the head
+    next_seq(name("arenas"));
+
+    // keep the config snapshot in sync
+    rebuild_conf_snapshot();
+}
+
+ACTION alienrumblex::rebuildconf() {
+    // check for self auth
+    require_auth(get_self());
+
+    // rebuild the config snapshot from the config tables
+    rebuild_conf_snapshot();
 }
 
 ACTION alienrumblex::startbattle(const name &arena_name) {
     // check for self auth
     require_auth(get_self());
 
-    // get arenas table
-    auto arenas = get_arenas();
+    // get the config snapshot
+    auto conf = get_conf_snapshot();
 
     // find the specified arena
-    auto arena = arenas.require_find(arena_name.value, "arena not found");
+    auto arena = find_arena_conf(conf, arena_name);
+    check(arena != nullptr, "arena not found");
 
     auto queues = get_queues();
     auto queue_size = distance(queues.cbegin(), queues.cend());
 
     check(queue_size > 0, "queue size must be > 0");
 
-    auto crews = get_crews_conf();
-    auto weapons = get_weapons_conf();
+    // reserve a change feed sequence number for every queue row that may change
+    auto queues_seq = next_seq(name("queues"), queue_size);
+
+    // get balances table
+    auto balances = get_balances();
 
     map<name, float> warriors{};
 
@@ -127,8 +158,9 @@ ACTION alienrumblex::startbattle(const name &arena_name) {
     auto itr1 = queues.begin();
 
     while (itr1 != queues.end()) {
-        // make a new queue list as itr1->queues is a const
+        // make new queue & reservation lists as the row's ones are const
         vector<queue_entry> new_queue(itr1->queues);
+        auto new_reservations = get_reservations(*itr1);
 
         auto arena_entry = find_if(new_queue.begin(), new_queue.end(),
                                    [&arena = arena_name](const queue_entry &entry) {
@@ -140,45 +172,60 @@ ACTION alienrumblex::startbattle(const name &arena_name) {
             continue;
         }
 
-        // erase the current entry
+        // erase the current entry & its reservation, keeping copies as the iterator is invalidated
+        auto index = distance(new_queue.begin(), arena_entry);
+        auto entry = new_queue[index];
+        auto reserved = new_reservations[index];
         new_queue.erase(arena_entry);
+        new_reservations.erase(new_reservations.begin() + index);
+
+        // save the remaining entries of the row
+        auto seq = queues_seq++;
+        auto save_queue = [&]() {
+            itr1 = modify_with_seq(queues, itr1, seq, [&](auto &row) {
+                row.queues = new_queue;
+                row.reservations.emplace(new_reservations);
+            });
+        };
 
         ++warrior_count;
 
+        // the arena cost reserved by this entry is now spent
+        release_reserved(balances, itr1->player, reserved);
+
         // get the user's assets
         auto assets = atomicassets::get_assets(itr1->player);
 
         // check if user owns the specified assets
-        auto minion = assets.find(arena_entry->minion_id);
-        auto weapon = assets.find(arena_entry->weapon_id);
+        auto minion = assets.find(entry.minion_id);
+        auto weapon = assets.find(entry.weapon_id);
 
         // skip this user if they don't own these assets anymore
         if (minion == assets.end() || weapon == assets.end()) {
-            queues.modify(itr1, same_payer, [&](auto &row) { row.queues = new_queue; });
+            save_queue();
             itr1++;
             continue;
         }
 
         // check if assets are valid
-        auto minion_conf = crews.find(minion->template_id);
-        auto weapon_conf = weapons.find(weapon->template_id);
+        auto minion_stats = get_unit_stats(conf, *minion, CREW_SCHEMA);
+        auto weapon_stats = get_unit_stats(conf, *weapon, ARMS_SCHEMA);
 
         // skip this user if these assets are not valid
         // this shouldn't happen as the enterqueue action checks for this
         // but keep this check here just in case
-        if (minion_conf == crews.end() || weapon_conf == weapons.end()) {
-            queues.modify(itr1, same_payer, [&](auto &row) { row.queues = new_queue; });
+        if (!minion_stats || !weapon_stats) {
+            save_queue();
             itr1++;
             continue;
         }
 
         // check if the minion & weapon have same
-        float multiplier = minion_conf->element == weapon_conf->weapon_class ? 1.0 : 0.5;
-        float score = multiplier * (minion_conf->attack + minion_conf->defense +
-                                    weapon_conf->attack + weapon_conf->defense);
+        float multiplier = minion_stats->element == weapon_stats->element ? 1.0 : 0.5;
+        float score = multiplier * (minion_stats->power + weapon_stats->power);
         warriors[itr1->player] = score;
 
-        queues.modify(itr1, same_payer, [&](auto &row) { row.queues = new_queue; });
+        save_queue();
         itr1++;
     }
 
@@ -207,11 +254,15 @@ ACTION alienrumblex::startbattle(const name &arena_name) {
     // get battles table
     auto battles = get_battles();
 
+    // get the change feed sequence number of the new battle
+    auto battles_seq = next_seq(name("battles"));
+
     // insert a new record
     auto new_battle = battles.emplace(get_self(), [&](auto &row) {
         row.battle_id = battles.available_primary_key();
         row.arena_name = arena_name;
         row.players = players;
+        row.seq.emplace(battles_seq);
     });
 
     vector<name> contenders = {contender1.second, contender2.second, contender3.second};
@@ -220,6 +271,19 @@ ACTION alienrumblex::startbattle(const name &arena_name) {
     uint64_t rand_index = tx_rand(3);
     auto winner = contenders[rand_index];
 
+    // update the stats of every warrior at once
+    auto stats = get_stats();
+    for (const auto &player : players) {
+        // migrate the player first, their entry may not have touched the balances table
+        check_user_registered(balances, player);
+        auto player_stats = stats.require_find(player.value, "user is not registered");
+
+        stats.modify(player_stats, same_payer, [&](auto &row) {
+            row.battle_count = player_stats->battle_count + 1;
+            row.win_count = player_stats->win_count + (player == winner ? 1 : 0);
+        });
+    }
+
     // log the winner
     action(permission_level{get_self(), name("active")}, get_self(), name("logwinner"),
            make_tuple(new_battle->battle_id, winner))
@@ -236,32 +300,110 @@ ACTION alienrumblex::logwinner(const uint64_t &battle_id, const name &winner) {
     // find the specified arena
     auto battle = battles.require_find(battle_id, "battle not found");
 
-    // get arenas table
-    auto arenas = get_arenas();
-
-    // find the specified arena
-    auto arena = arenas.require_find(battle->arena_name.value, "arena not found");
+    // find the specified arena in the config snapshot
+    auto conf = get_conf_snapshot();
+    auto arena = find_arena_conf(conf, battle->arena_name);
+    check(arena != nullptr, "arena not found");
 
     auto warrior_count = distance(battle->players.cbegin(), battle->players.cend());
 
-    battles.modify(battle, same_payer, [&](auto &row) {
+    // get the change feed sequence number of the battle result
+    auto battles_seq = next_seq(name("battles"));
+
+    modify_with_seq(battles, battle, battles_seq, [&](auto &row) {
         row.winner = winner;
         row.timestamp = time_point_sec(current_time_point());
     });
 
     // calculate the prize amount
     auto percentage = (100 - arena->fee) / 100.0f;
-    auto prize = extended_asset(
-        asset((uint64_t)(arena->cost.quantity.amount * warrior_count * percentage), TLM_SYMBOL),
-        TLM_CONTRACT);
+    auto prize = asset((uint64_t)(arena->cost.amount * warrior_count * percentage), TLM_SYMBOL);
+
+    auto balances = get_balances();
+    auto balance = check_user_registered(balances, winner);
+
+    // in auto-payout mode the prize goes to the payout ledger instead of the balance
+    if (get_settings().get_or_default().auto_payout) {
+        auto payouts = get_payouts();
+        auto pending = payouts.find(winner.value);
+
+        // merge the prize with the winner's pending payout
+        if (pending == payouts.end()) {
+            payouts.emplace(get_self(), [&](auto &row) {
+                row.account = winner;
+                row.quantity = prize;
+                row.win_count = 1;
+                row.since = time_point_sec(current_time_point());
+            });
+        } else {
+            payouts.modify(pending, same_payer, [&](auto &row) {
+                row.quantity = pending->quantity + prize;
+                row.win_count = pending->win_count + 1;
+            });
+        }
+    } else {
+        // increase the balance of the winner
+        balances.modify(balance, same_payer,
+                        [&](auto &row) { row.balance = balance->balance + prize; });
+    }
+}
 
-    auto account = check_user_registered(winner);
+ACTION alienrumblex::setautopay(const bool &enabled) {
+    // check for self auth
+    require_auth(get_self());
 
-    // increase the balance and win_count of the winner
-    get_accounts().modify(account, same_payer, [&](auto &row) {
-        row.balance = account->balance + prize;
-        row.win_count = account->win_count + 1;
-    });
+    // save the payout mode
+    auto settings = get_settings();
+    auto config = settings.get_or_default();
+    config.auto_payout = enabled;
+    settings.set(config, get_self());
+}
+
+ACTION alienrumblex::payout(const uint64_t &max_rows) {
+    // check for self auth
+    require_auth(get_self());
+
+    check(max_rows > 0, "max_rows must be > 0");
+
+    // get payouts table
+    auto payouts = get_payouts();
+
+    check(payouts.begin() != payouts.end(), "no pending payouts");
+
+    // settle at most max_rows payouts, one transfer per account
+    uint64_t count = 0;
+    auto itr = payouts.begin();
+    while (itr != payouts.end() && count < max_rows) {
+        if (itr->quantity.amount > 0) {
+            action(permission_level{get_self(), name("active")}, TLM_CONTRACT, name("transfer"),
+                   make_tuple(get_self(), itr->account, itr->quantity,
+                              string("AlienRumbleX winnings")))
+                .send();
+        }
+
+        itr = payouts.erase(itr);
+        ++count;
+    }
+}
+
+ACTION alienrumblex::creditpay(const name &account) {
+    // check for self auth
+    require_auth(get_self());
+
+    // get payouts table
+    auto payouts = get_payouts();
+
+    // find the pending payout, e.g. one whose transfer keeps failing
+    auto pending = payouts.require_find(account.value, "no pending payout for this account");
+
+    auto balances = get_balances();
+    auto balance = check_user_registered(balances, account);
+
+    // move the payout to the in-game balance, the winner can withdraw it themselves
+    balances.modify(balance, same_payer,
+                    [&](auto &row) { row.balance = balance->balance + pending->quantity; });
+
+    payouts.erase(pending);
 }
 
 ACTION alienrumblex::fullreset() {
@@ -280,9 +422,62 @@ ACTION alienrumblex::fullreset() {
     // get queues table
     auto queues = get_queues();
 
+    auto balances = get_balances();
+
     // iterate through the rows and erase them
     auto itr_q = queues.begin();
     while (itr_q != queues.end()) {
+        // the entry fees of the erased entries are forfeited like they always were,
+        // their reservations are only released so that no reserved amount is left over
+        for (const auto &reserved : get_reservations(*itr_q)) {
+            release_reserved(balances, itr_q->player, reserved);
+        }
+
         itr_q = queues.erase(itr_q);
     }
+
+    // bump the change feed so clients drop their cached queues and battles
+    next_seq(name("reset"));
+}
+
+ACTION alienrumblex::migrateaccs(const uint64_t &max_rows) {
+    // check for self auth
+    require_auth(get_self());
+
+    check(max_rows > 0, "max_rows must be > 0");
+
+    // get the legacy accounts table
+    auto accounts = get_accounts();
+
+    check(accounts.begin() != accounts.end(), "no accounts to migrate");
+
+    // move at most max_rows accounts to the balances & stats tables
+    uint64_t count = 0;
+    auto itr = accounts.begin();
+    while (itr != accounts.end() && count < max_rows) {
+        itr = migrate_account(accounts, itr);
+        ++count;
+    }
+}
+
+ACTION alienrumblex::migrateseq(const name &table, const uint64_t &lower_bound,
+                                const uint64_t &max_rows) {
+    // check for self auth
+    require_auth(get_self());
+
+    check(max_rows > 0, "max_rows must be > 0");
+
+    // give the rows written before the change feed a sequence number
+    if (table == name("arenas")) {
+        auto arenas = get_arenas();
+        backfill_seq(arenas, table, lower_bound, max_rows);
+    } else if (table == name("queues")) {
+        auto queues = get_queues();
+        backfill_seq(queues, table, lower_bound, max_rows);
+    } else if (table == name("battles")) {
+        auto battles = get_battles();
+        backfill_seq(battles, table, lower_bound, max_rows);
+    } else {
+        check(false, "unknown change feed table");
+    }
 }
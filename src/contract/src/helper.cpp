@@ -1,14 +1,60 @@
+alienrumblex::balances_table::const_iterator
+alienrumblex::check_user_registered(balances_table &balances, const name &user) {
+    auto balance = balances.find(user.value);
+    if (balance != balances.end()) {
+        return balance;
+    }
 
-alienrumblex::accounts_table::const_iterator
-alienrumblex::check_user_registered(const name &user) {
-    // get accounts table
-    accounts_table accounts(get_self(), get_self().value);
+    // users still in the legacy accounts table are migrated on the fly
+    auto accounts = get_accounts();
+    auto account = accounts.require_find(user.value, "user is not registered");
+    migrate_account(accounts, account);
 
     // check if user is registered
-    return accounts.require_find(user.value, "user is not registered");
+    return balances.require_find(user.value, "user is not registered");
+}
+
+alienrumblex::accounts_table::const_iterator
+alienrumblex::migrate_account(accounts_table &accounts, accounts_table::const_iterator account) {
+    // move the balance to the balances table
+    get_balances().emplace(get_self(), [&](auto &row) {
+        row.account = account->account;
+        row.balance = account->balance.quantity;
+        row.reserved = asset(0, TLM_SYMBOL);
+    });
+
+    // move the battle stats to the stats table
+    get_stats().emplace(get_self(), [&](auto &row) {
+        row.account = account->account;
+        row.battle_count = account->battle_count;
+        row.win_count = account->win_count;
+    });
+
+    // delete the legacy row
+    return accounts.erase(account);
+}
+
+void alienrumblex::release_reserved(balances_table &balances, const name &user,
+                                    const asset &quantity) {
+    if (quantity.amount == 0) {
+        return;
+    }
+
+    auto balance = check_user_registered(balances, user);
+
+    check(balance->reserved >= quantity, "reserved amount is lower than the released amount");
+
+    balances.modify(balance, same_payer,
+                    [&](auto &row) { row.reserved = balance->reserved - quantity; });
 }
 
-void alienrumblex::check_user_weapon(const name &user, const uint64_t &asset_id) {
+vector<asset> alienrumblex::get_reservations(const queue_entity &queue) {
+    // entries made before the balances migration have nothing reserved
+    return queue.reservations.value_or(vector<asset>(queue.queues.size(), asset(0, TLM_SYMBOL)));
+}
+
+void alienrumblex::check_user_weapon(const name &user, const uint64_t &asset_id,
+                                     conf_snapshot_entity &conf) {
     // get the user's assets
     auto assets = atomicassets::get_assets(user);
 
@@ -16,15 +62,13 @@ void alienrumblex::check_user_weapon(const name &user, const uint64_t &asset_id)
     auto weapon = assets.require_find(
         asset_id, string("user doesn't own asset: " + to_string(asset_id)).c_str());
 
-    // get the weapons configs
-    auto weapon_confs = get_weapons_conf();
-
-    // check if the minion belongs to the user
-    weapon_confs.require_find(weapon->template_id,
-                              string("asset " + to_string(asset_id) + " is not valid").c_str());
+    // check if the weapon has battle stats
+    check(get_unit_stats(conf, *weapon, ARMS_SCHEMA).has_value(),
+          string("asset " + to_string(asset_id) + " is not valid").c_str());
 }
 
-void alienrumblex::check_user_crew(const name &user, const uint64_t &asset_id) {
+void alienrumblex::check_user_crew(const name &user, const uint64_t &asset_id,
+                                   conf_snapshot_entity &conf) {
     // get the user's assets
     auto assets = atomicassets::get_assets(user);
 
@@ -32,12 +76,195 @@ void alienrumblex::check_user_crew(const name &user, const uint64_t &asset_id) {
     auto minion = assets.require_find(
         asset_id, string("user doesn't own asset: " + to_string(asset_id)).c_str());
 
-    // get the crew configs
-    auto crew_confs = get_crews_conf();
+    // check if the minion has battle stats
+    check(get_unit_stats(conf, *minion, CREW_SCHEMA).has_value(),
+          string("asset " + to_string(asset_id) + " is not valid").c_str());
+}
 
-    // check if the minion belongs to the user
-    crew_confs.require_find(minion->template_id,
-                            string("asset " + to_string(asset_id) + " is not valid").c_str());
+optional<alienrumblex::unit_stats>
+alienrumblex::get_unit_stats(conf_snapshot_entity &conf, const atomicassets::assets_s &asset,
+                             const name &schema_name) {
+    // operator configs take precedence over the template attributes
+    auto entry =
+        find_conf(schema_name == CREW_SCHEMA ? conf.crews : conf.weapons, asset.template_id);
+    if (entry != nullptr) {
+        return unit_stats{conf.elements[entry->element], entry->power};
+    }
+
+    // only alien worlds crews/weapons with a template have usable attributes
+    if (asset.collection_name != AW_COLLECTION || asset.schema_name != schema_name ||
+        asset.template_id < 0) {
+        return nullopt;
+    }
+
+    // templates are immutable, so they're only decoded the first time they're seen
+    entry = find_conf(conf.templates, asset.template_id);
+    if (entry == nullptr && !binary_search(conf.invalid_templates.begin(),
+                                           conf.invalid_templates.end(),
+                                           (uint64_t)asset.template_id)) {
+        entry = cache_template_stats(conf, asset);
+    }
+
+    if (entry == nullptr) {
+        return nullopt;
+    }
+
+    return unit_stats{conf.elements[entry->element], entry->power};
+}
+
+const alienrumblex::conf_entry *
+alienrumblex::cache_template_stats(conf_snapshot_entity &conf,
+                                   const atomicassets::assets_s &asset) {
+    uint64_t template_id = asset.template_id;
+    auto stats = get_template_stats(asset);
+
+    // keep both lists sorted for binary search
+    if (stats) {
+        auto itr = lower_bound(conf.templates.begin(), conf.templates.end(), template_id,
+                               [](const conf_entry &entry, const uint64_t &id) {
+                                   return entry.template_id < id;
+                               });
+        conf.templates.insert(itr, {template_id, element_index(conf, stats->element),
+                                    (uint16_t)(stats->attack + stats->defense)});
+    } else {
+        // templates without battle attributes are cached too, so they're not decoded again
+        // (an enterqueue rejecting the asset reverts this, startbattle keeps it)
+        auto itr =
+            lower_bound(conf.invalid_templates.begin(), conf.invalid_templates.end(), template_id);
+        conf.invalid_templates.insert(itr, template_id);
+    }
+
+    conf_snapshot_singleton(get_self(), get_self().value).set(conf, get_self());
+
+    return find_conf(conf.templates, template_id);
+}
+
+optional<alienrumblex::template_stats>
+alienrumblex::get_template_stats(const atomicassets::assets_s &asset) {
+    // find the template & its schema
+    auto templates = atomicassets::get_templates(asset.collection_name);
+    auto tmpl = templates.find(asset.template_id);
+    if (tmpl == templates.end()) {
+        return nullopt;
+    }
+
+    auto schemas = atomicassets::get_schemas(asset.collection_name);
+    auto schema = schemas.find(tmpl->schema_name.value);
+    if (schema == schemas.end()) {
+        return nullopt;
+    }
+
+    // crews have an element, weapons have a class
+    string element_attribute = tmpl->schema_name == CREW_SCHEMA ? "element" : "class";
+
+    template_stats stats{};
+
+    bool has_element = false;
+    bool has_attack = false;
+    bool has_defense = false;
+
+    // clamp the integer attributes to the range of the stats
+    auto to_stat = [](const int64_t &value) -> uint8_t {
+        return max<int64_t>(0, min<int64_t>(value, UINT8_MAX));
+    };
+
+    // only read the needed attributes, the others are skipped
+    atomicdata::for_each_attribute(
+        tmpl->immutable_serialized_data, schema->format,
+        [&](const atomicdata::attribute_view &attribute) {
+            const string &attribute_name = attribute.format->name;
+
+            if (attribute_name == element_attribute) {
+                stats.element = string(atomicdata::as_string(attribute));
+                has_element = true;
+            } else if (attribute_name == "attack") {
+                stats.attack = to_stat(atomicdata::as_int(attribute));
+                has_attack = true;
+            } else if (attribute_name == "defense") {
+                stats.defense = to_stat(atomicdata::as_int(attribute));
+                has_defense = true;
+            }
+        });
+
+    // templates without battle attributes can't fight
+    if (!has_element || !has_attack || !has_defense) {
+        return nullopt;
+    }
+
+    return stats;
+}
+
+const alienrumblex::conf_entry *alienrumblex::find_conf(const vector<conf_entry> &confs,
+                                                        const uint64_t &template_id) {
+    // binary search the template in the sorted entries
+    auto itr = lower_bound(confs.begin(), confs.end(), template_id,
+                           [](const conf_entry &entry, const uint64_t &id) {
+                               return entry.template_id < id;
+                           });
+
+    if (itr == confs.end() || itr->template_id != template_id) {
+        return nullptr;
+    }
+
+    return &(*itr);
+}
+
+const alienrumblex::arena_conf_entry *
+alienrumblex::find_arena_conf(const conf_snapshot_entity &conf, const name &arena_name) {
+    // binary search the arena in the sorted entries
+    auto itr = lower_bound(conf.arenas.begin(), conf.arenas.end(), arena_name,
+                           [](const arena_conf_entry &entry, const name &arena) {
+                               return entry.arena_name.value < arena.value;
+                           });
+
+    if (itr == conf.arenas.end() || itr->arena_name != arena_name) {
+        return nullptr;
+    }
+
+    return &(*itr);
+}
+
+uint8_t alienrumblex::element_index(conf_snapshot_entity &conf, const string &element) {
+    // get the index of an element/class, adding it if it's a new one
+    auto itr = find(conf.elements.begin(), conf.elements.end(), element);
+    if (itr != conf.elements.end()) {
+        return distance(conf.elements.begin(), itr);
+    }
+
+    check(conf.elements.size() <= UINT8_MAX, "too many elements");
+    conf.elements.push_back(element);
+    return conf.elements.size() - 1;
+}
+
+void alienrumblex::rebuild_conf_snapshot() {
+    conf_snapshot_singleton snapshot(get_self(), get_self().value);
+    auto current = snapshot.get_or_default();
+
+    conf_snapshot_entity conf{};
+    conf.version = current.version + 1;
+
+    // the decoded templates don't depend on the config tables, so they're kept
+    // along with the elements they refer to
+    conf.elements = current.elements;
+    conf.templates = current.templates;
+    conf.invalid_templates = current.invalid_templates;
+
+    // the config tables are iterated by primary key, so the entries end up sorted
+    for (const auto &crew : get_crews_conf()) {
+        conf.crews.push_back({crew.template_id, element_index(conf, crew.element),
+                              (uint16_t)(crew.attack + crew.defense)});
+    }
+
+    for (const auto &weapon : get_weapons_conf()) {
+        conf.weapons.push_back({weapon.template_id, element_index(conf, weapon.weapon_class),
+                                (uint16_t)(weapon.attack + weapon.defense)});
+    }
+
+    for (const auto &arena : get_arenas()) {
+        conf.arenas.push_back({arena.name, arena.cost.quantity, arena.fee});
+    }
+
+    snapshot.set(conf, get_self());
 }
 
 uint64_t alienrumblex::tx_rand(const uint64_t &upper_limit) {
@@ -59,11 +286,105 @@ uint64_t alienrumblex::tx_rand(const uint64_t &upper_limit) {
     return nonce_value % upper_limit;
 }
 
+uint64_t alienrumblex::next_seq(const name &table, const uint64_t &count) {
+    // get the change feed head
+    auto head = get_head();
+    auto state = head.get_or_default();
+
+    // reserve count sequence numbers, clients page the seq indexes so every
+    // written row needs its own one
+    state.seq += count;
+
+    // record the sequence number of the last change of the affected table
+    if (table == name("arenas")) {
+        state.arenas_seq = state.seq;
+    } else if (table == name("queues")) {
+        state.queues_seq = state.seq;
+    } else if (table == name("battles")) {
+        state.battles_seq = state.seq;
+    } else if (table == name("reset")) {
+        // a reset wipes the queues and battles, clients must fetch them again
+        state.queues_seq = state.seq;
+        state.battles_seq = state.seq;
+        state.reset_seq = state.seq;
+    } else {
+        check(false, "unknown change feed table");
+    }
+
+    head.set(state, get_self());
+
+    // return the first reserved sequence number
+    return state.seq - count + 1;
+}
+
+template <typename T, typename F>
+typename T::const_iterator alienrumblex::modify_with_seq(T &rows, typename T::const_iterator itr,
+                                                         const uint64_t &seq, F &&updater) {
+    if (itr->seq.has_value()) {
+        rows.modify(itr, same_payer, [&](auto &row) {
+            updater(row);
+            row.seq.emplace(seq);
+        });
+        return itr;
+    }
+
+    // rows written before the seq field have no entry in the seq index and modify can't
+    // create it, so the row is erased & emplaced again (the contract pays for the RAM)
+    auto backfilled = *itr;
+    updater(backfilled);
+    backfilled.seq.emplace(seq);
+
+    rows.erase(itr);
+    return rows.emplace(get_self(), [&](auto &row) { row = backfilled; });
+}
+
+template <typename T>
+void alienrumblex::backfill_seq(T &rows, const name &table, const uint64_t &lower_bound,
+                                const uint64_t &max_rows) {
+    // visit at most max_rows rows, starting at lower_bound
+    uint64_t count = 0;
+    auto itr = rows.lower_bound(lower_bound);
+    while (itr != rows.end() && count < max_rows) {
+        ++count;
+
+        // rows changed since the upgrade already have a sequence number
+        if (!itr->seq.has_value()) {
+            itr = modify_with_seq(rows, itr, next_seq(table), [](auto &) {});
+        }
+
+        ++itr;
+    }
+}
+
 // getter functions
+alienrumblex::settings_singleton alienrumblex::get_settings() {
+    return settings_singleton(get_self(), get_self().value);
+}
+
+alienrumblex::head_singleton alienrumblex::get_head() {
+    return head_singleton(get_self(), get_self().value);
+}
+
+alienrumblex::conf_snapshot_entity alienrumblex::get_conf_snapshot() {
+    return conf_snapshot_singleton(get_self(), get_self().value).get_or_default();
+}
+
 alienrumblex::accounts_table alienrumblex::get_accounts() {
     return accounts_table(get_self(), get_self().value);
 }
 
+alienrumblex::balances_table alienrumblex::get_balances() {
+    return balances_table(get_self(), get_self().value);
+}
+
+alienrumblex::stats_table alienrumblex::get_stats() {
+    return stats_table(get_self(), get_self().value);
+}
+
+alienrumblex::payouts_table alienrumblex::get_payouts() {
+    return payouts_table(get_self(), get_self().value);
+}
+
 alienrumblex::weapons_conf_table alienrumblex::get_weapons_conf() {
     return weapons_conf_table(get_self(), get_self().value);
 }
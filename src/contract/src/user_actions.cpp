@@ -1,5 +1,5 @@
 /*
-    Register a new user and save them in accounts table
+    Register a new user and save them in the balances & stats tables
 
     @param {name} user - the name of the account
 
@@ -9,17 +9,31 @@ ACTION alienrumblex::regnewuser(const name &user) {
     // check for caller auth
     require_auth(user);
 
-    // get accounts table
-    accounts_table accounts(get_self(), get_self().value);
-    auto account = accounts.find(user.value);
+    // get balances table
+    auto balances = get_balances();
+    auto balance = balances.find(user.value);
 
     // check if the account is not already registered
-    check(account == accounts.end(), "user already registered");
+    check(balance == balances.end(), "user already registered");
+
+    // users of the legacy accounts table only need to be migrated
+    auto accounts = get_accounts();
+    auto account = accounts.find(user.value);
+
+    if (account != accounts.end()) {
+        migrate_account(accounts, account);
+        return;
+    }
 
     // emplace a new user row
-    accounts.emplace(user, [&](auto &row) {
+    balances.emplace(user, [&](auto &row) {
+        row.account = user;
+        row.balance = asset(0, TLM_SYMBOL);
+        row.reserved = asset(0, TLM_SYMBOL);
+    });
+
+    get_stats().emplace(user, [&](auto &row) {
         row.account = user;
-        row.balance = extended_asset(asset(0, TLM_SYMBOL), TLM_CONTRACT);
         row.battle_count = 0;
         row.win_count = 0;
     });
@@ -40,24 +54,29 @@ ACTION alienrumblex::enterqueue(const name &user, const name &arena_name,
     // check for caller auth
     require_auth(user);
 
-    // check if user is registered & find the user's account
-    auto account = check_user_registered(user);
+    // check if user is registered & find the user's balance
+    auto balances = get_balances();
+    auto balance = check_user_registered(balances, user);
 
     // check if a config exists
-    auto arenas = get_arenas();
+    auto conf = get_conf_snapshot();
 
-    auto arena = arenas.require_find(arena_name.value, "invalid arena");
+    auto arena = find_arena_conf(conf, arena_name);
+    check(arena != nullptr, "invalid arena");
 
     // check if the user has enough balance to enter
-    check(account->balance >= arena->cost, "insufficient balance to enter this arena");
+    check(balance->balance >= arena->cost, "insufficient balance to enter this arena");
 
     // check if user provided assets are valid
-    check_user_crew(user, minion_id);
-    check_user_weapon(user, weapon_id);
+    check_user_crew(user, minion_id, conf);
+    check_user_weapon(user, weapon_id, conf);
 
     // get queues table
     auto queues = get_queues();
 
+    // get the change feed sequence number of this change
+    auto seq = next_seq(name("queues"));
+
     // check if user is not already entered in an arena
     auto user_queue = queues.find(user.value);
 
@@ -81,27 +100,31 @@ ACTION alienrumblex::enterqueue(const name &user, const name &arena_name,
         vector<queue_entry> new_queue(user_queue->queues);
         new_queue.push_back({arena_name, minion_id, weapon_id});
 
+        // record the reserved cost so that only this entry releases it
+        auto new_reservations = get_reservations(*user_queue);
+        new_reservations.push_back(arena->cost);
+
         // modify the row in the queues tables
-        queues.modify(user_queue, same_payer, [&](auto &row) {
+        modify_with_seq(queues, user_queue, seq, [&](auto &row) {
             row.player = user;
             row.queues = new_queue;
+            row.reservations.emplace(new_reservations);
         });
     } else {
         // emplace a new row in the queue
         queues.emplace(user, [&](auto &row) {
             row.player = user;
             row.queues = {{arena_name, minion_id, weapon_id}};
+            row.seq.emplace(seq);
+            row.reservations.emplace(vector<asset>{arena->cost});
         });
     }
 
-    auto accounts = get_accounts();
-    // redefine account to avoid "object passed to modify is not in multi_index" issue
-    account = accounts.find(user.value);
-
-    // deduct the arena cost from the player's balance
-    accounts.modify(account, same_payer, [&](auto &row) {
-        row.balance = account->balance - arena->cost;
-        row.battle_count = account->battle_count + 1;
+    // move the arena cost from the player's balance to their reserved amount
+    // the battle count is updated once the battle is resolved
+    balances.modify(balance, same_payer, [&](auto &row) {
+        row.balance = balance->balance - arena->cost;
+        row.reserved = balance->reserved + arena->cost;
     });
 
     // count the number of players in currently waiting for this arena
@@ -139,15 +162,16 @@ ACTION alienrumblex::withdraw(const name &user, const asset &quantity) {
     check(quantity.is_valid(), "invalid quantity");
     check(quantity.symbol == TLM_SYMBOL, "invalid token symbol");
 
-    // check if user is registered & find the user's account
-    auto account = check_user_registered(user);
+    // check if user is registered & find the user's balance
+    auto balances = get_balances();
+    auto balance = check_user_registered(balances, user);
 
     // check if the user has enough balance to withdraw
-    check(account->balance.quantity >= quantity, "overdrawn balance");
+    check(balance->balance >= quantity, "overdrawn balance");
 
-    // save new account stats
-    get_accounts().modify(account, same_payer, [&](auto &row) {
-        row.balance = extended_asset(asset(account->balance.quantity - quantity), TLM_CONTRACT);
+    // save new balance
+    balances.modify(balance, same_payer, [&](auto &row) {
+        row.balance = balance->balance - quantity;
     });
 
     // send the amount
@@ -172,11 +196,12 @@ void alienrumblex::receive_tokens(name from, name to, asset quantity, string mem
     check(quantity.is_valid(), "invalid quantity");
     check(quantity.symbol == TLM_SYMBOL, "invalid token symbol");
 
-    // check if user is registered & find the user's account
-    auto account = check_user_registered(from);
+    // check if user is registered & find the user's balance
+    auto balances = get_balances();
+    auto balance = check_user_registered(balances, from);
 
-    // save new account stats
-    get_accounts().modify(account, same_payer, [&](auto &row) {
-        row.balance = extended_asset(asset(account->balance.quantity + quantity), TLM_CONTRACT);
+    // save new balance
+    balances.modify(balance, same_payer, [&](auto &row) {
+        row.balance = balance->balance + quantity;
     });
 }
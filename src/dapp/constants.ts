@@ -75,6 +75,9 @@ export interface AppContextInterface {
 	gameBalance: number;
 	setGameBalance: (balance: number) => void;
 
+	pendingPayout: number;
+	setPendingPayout: (payout: number) => void;
+
 	userInfo: GameUser | false;
 	setUserInfo: (info: GameUser | false) => void;
 
@@ -39,6 +39,7 @@ function AlienRumbleX(): JSX.Element {
 export default function App(props: React.PropsWithChildren<{ ual?: UAL }>): JSX.Element {
 	const [accountBalance, setAccountBalance] = useState<number>(NaN);
 	const [gameBalance, setGameBalance] = useState<number>(NaN);
+	const [pendingPayout, setPendingPayout] = useState<number>(0);
 	const [userInfo, setUserInfo] = useState<GameUser | false>(null);
 
 	const [crewConfs, setCrewConfs] = useState<CrewConf[]>(null);
@@ -61,6 +62,8 @@ export default function App(props: React.PropsWithChildren<{ ual?: UAL }>): JSX.
 				setAccountBalance,
 				gameBalance,
 				setGameBalance,
+				pendingPayout,
+				setPendingPayout,
 				userInfo,
 				setUserInfo,
 				crewConfs,
@@ -1,12 +1,12 @@
 import axios from "axios";
 import _ from "lodash";
-import React, { useContext, useEffect, useState } from "react";
+import React, { useContext, useEffect, useRef, useState } from "react";
 import { Link, useRouteMatch, withRouter } from "react-router-dom";
 import { SignTransactionResponse } from "universal-authenticator-library";
 import BottomBar from "../components/BottomBar";
 import Logo from "../components/Logo";
 import { AppCtx, BLOCKCHAIN, ENDPOINTS, RARITIES, SHINES } from "../constants";
-import { AssetItem, AssetTemplate, Crew, CrewConf, GameUser, Weapon, WeaponConf } from "../types";
+import { AssetItem, AssetTemplate, Battle, Crew, CrewConf, FeedHead, LegacyGameUser, PendingPayout, UserBalance, UserQueueEntry, UserStats, Weapon, WeaponConf } from "../types";
 import { getStorageItem, setStorageItem } from "../utils";
 import ArenasWindow from "../windows/Arenas";
 import BattlesWindow from "../windows/Battles";
@@ -23,6 +23,7 @@ function Game(): JSX.Element {
 		weapons,
 		setAccountBalance,
 		setGameBalance,
+		setPendingPayout,
 		setUserInfo,
 		crewConfs,
 		setCrewConfs,
@@ -49,6 +50,12 @@ function Game(): JSX.Element {
 	const [atomicEndpoints, setAtomicEndpoints] = useState<string[]>(null);
 	const [apiEndpoints, setAPIEndpoints] = useState<string[]>(null);
 
+	// last seen change feed head & the rows fetched so far, kept in refs so that
+	// concurrent refreshes always merge into the latest data
+	const feedHead = useRef<FeedHead>(null);
+	const queueRows = useRef<Map<string, UserQueueEntry>>(new Map());
+	const battleRows = useRef<Map<number, Battle>>(new Map());
+
 	let lastAutoRefetch = 0;
 
 	const match = useRouteMatch(["/home", "/arenas", "/battles", "/wallet"]);
@@ -138,11 +145,11 @@ function Game(): JSX.Element {
 
 		await Promise.all([
 			fetchAssetsTemplates("crew.worlds").then(minions => {
-				setStorageItem<AssetTemplate[]>("crew.worlds.templates", minions, 0);
+				setStorageItem<AssetTemplate[]>("crew.worlds.templates.v2", minions, 0);
 				return minions;
 			}),
 			fetchAssetsTemplates("arms.worlds").then(weapons => {
-				setStorageItem<AssetTemplate[]>("arms.worlds.templates", weapons, 0);
+				setStorageItem<AssetTemplate[]>("arms.worlds.templates.v2", weapons, 0);
 				return weapons;
 			}),
 		]).then(([minions, weapons]) => {
@@ -152,8 +159,7 @@ function Game(): JSX.Element {
 
 		await Promise.all([fetchCrewsConfigurations(), await fetchWeaponsConfigurations()]);
 		await fetchArenas();
-		await refreshQueue();
-		await refreshBattles();
+		await refreshTables(true);
 
 		refreshCrews();
 		refreshWeapons();
@@ -162,8 +168,96 @@ function Game(): JSX.Element {
 
 	const refreshData = () => {
 		refetchBalances();
-		refreshQueue();
-		refreshBattles();
+		refreshTables();
+	};
+
+	const refreshTables = async (forceRefetch = false) => {
+		const head = await fetchFeedHead();
+		const last = feedHead.current;
+
+		// the tables were wiped (or never fetched), start over
+		if (forceRefetch || !last || head.reset_seq > last.seq) {
+			queueRows.current = new Map();
+			battleRows.current = new Map();
+			await Promise.all([refreshQueue(), refreshBattles()]);
+		} else {
+			// only fetch the rows changed since the last refresh
+			await Promise.all([
+				head.queues_seq > last.queues_seq && refreshQueue(last.queues_seq),
+				head.battles_seq > last.battles_seq && refreshBattles(last.battles_seq),
+				head.arenas_seq > last.arenas_seq && fetchArenas(),
+			]);
+		}
+
+		feedHead.current = head;
+	};
+
+	const fetchFeedHead = async (): Promise<FeedHead> => {
+		const response = await axios.post(
+			`https://${BLOCKCHAIN.API_ENDPOINT}/v1/chain/get_table_rows`,
+			{ json: true, code: BLOCKCHAIN.DAPP_CONTRACT, scope: BLOCKCHAIN.DAPP_CONTRACT, table: "head", limit: 1 },
+			{ responseType: "json", headers: { "Content-Type": "application/json;charset=UTF-8" } },
+		);
+
+		return response.data.rows[0] || { seq: 0, arenas_seq: 0, queues_seq: 0, battles_seq: 0, reset_seq: 0 };
+	};
+
+	/**
+	 * Fetch the rows of a contract table changed after the given sequence number
+	 * @param table the name of the table
+	 * @param indexPosition the position of the table's `seq` index
+	 * @param since the last seen sequence number
+	 */
+	const fetchTableChanges = async <T,>(table: string, indexPosition: string, since: number): Promise<T[]> =>
+		fetchTableRows<T>(table, indexPosition, `${since + 1}`);
+
+	/**
+	 * Fetch all the rows of a contract table from the given key of an index
+	 * @param table the name of the table
+	 * @param indexPosition the position of the index
+	 * @param lowerBound the first key to fetch
+	 */
+	const fetchTableRows = async <T,>(table: string, indexPosition: string, lowerBound: string): Promise<T[]> => {
+		const rows: T[] = [];
+
+		// eslint-disable-next-line no-constant-condition
+		while (true) {
+			const response = await axios.post(
+				`https://${BLOCKCHAIN.API_ENDPOINT}/v1/chain/get_table_rows`,
+				{
+					json: true,
+					code: BLOCKCHAIN.DAPP_CONTRACT,
+					scope: BLOCKCHAIN.DAPP_CONTRACT,
+					table,
+					index_position: indexPosition,
+					key_type: "i64",
+					lower_bound: lowerBound,
+					limit: 1000,
+				},
+				{ responseType: "json", headers: { "Content-Type": "application/json;charset=UTF-8" } },
+			);
+
+			rows.push(...response.data.rows);
+
+			// stop if the page can't move forward, a page would be fetched again forever
+			if (!response.data.more || `${response.data.next_key}` === lowerBound) {
+				break;
+			}
+
+			lowerBound = `${response.data.next_key}`;
+		}
+
+		return rows;
+	};
+
+	const fetchLatestBattles = async (): Promise<Battle[]> => {
+		const response = await axios.post(
+			`https://${BLOCKCHAIN.API_ENDPOINT}/v1/chain/get_table_rows`,
+			{ json: true, code: BLOCKCHAIN.DAPP_CONTRACT, scope: BLOCKCHAIN.DAPP_CONTRACT, table: "battles", reverse: true, limit: 1000 },
+			{ responseType: "json", headers: { "Content-Type": "application/json;charset=UTF-8" } },
+		);
+
+		return response.data.rows;
 	};
 
 	const refreshCrews = () => {
@@ -171,6 +265,7 @@ function Game(): JSX.Element {
 			return;
 		}
 
+		// the game's configs take precedence over the stats of the templates, like in the contract
 		const assets = crewAssets?.map<Crew>(minion => ({
 			...minion,
 			...assetsTemplates?.find(t => t.template_id == minion.template_id),
@@ -189,6 +284,7 @@ function Game(): JSX.Element {
 			return;
 		}
 
+		// the game's configs take precedence over the stats of the templates, like in the contract
 		const assets = weaponAssets?.map<Weapon>(weapon => ({
 			...weapon,
 			...assetsTemplates?.find(t => t.template_id == weapon.template_id),
@@ -207,28 +303,26 @@ function Game(): JSX.Element {
 		fetchAccountBalance();
 	};
 
-	const refreshBattles = async () => {
-		const response = await axios.post(
-			`https://${BLOCKCHAIN.API_ENDPOINT}/v1/chain/get_table_rows`,
-			{ json: true, code: BLOCKCHAIN.DAPP_CONTRACT, scope: BLOCKCHAIN.DAPP_CONTRACT, table: "battles", limit: 1000 },
-			{ responseType: "json", headers: { "Content-Type": "application/json;charset=UTF-8" } },
-		);
+	const refreshBattles = async (since = 0) => {
+		// the first load is capped to the latest battles, the next ones only fetch the changes
+		const rows = since ? await fetchTableChanges<Battle>("battles", "fourth", since) : await fetchLatestBattles();
+		rows.forEach(b => battleRows.current.set(b.battle_id, { ...b, timestamp: `${b.timestamp}Z` }));
 
-		setBattles(response.data.rows.map(b => ({ ...b, timestamp: `${b.timestamp}Z` })));
+		setBattles([...battleRows.current.values()]);
 	};
 
-	const refreshQueue = async () => {
-		const response = await axios.post(
-			`https://${BLOCKCHAIN.API_ENDPOINT}/v1/chain/get_table_rows`,
-			{ json: true, code: BLOCKCHAIN.DAPP_CONTRACT, scope: BLOCKCHAIN.DAPP_CONTRACT, table: "queues", limit: 1000 },
-			{ responseType: "json", headers: { "Content-Type": "application/json;charset=UTF-8" } },
-		);
+	const refreshQueue = async (since = 0) => {
+		// the first load reads the primary index, rows written before the change feed have no sequence number yet
+		const rows = since
+			? await fetchTableChanges<UserQueueEntry>("queues", "secondary", since)
+			: await fetchTableRows<UserQueueEntry>("queues", "primary", "");
+		rows.forEach(q => queueRows.current.set(q.player, q));
 
-		setQueue(response.data.rows);
+		setQueue([...queueRows.current.values()]);
 	};
 
 	const fetchAssetsTemplates = async (schema: string): Promise<AssetTemplate[]> => {
-		const cache = getStorageItem<AssetTemplate[]>(`${schema}.templates`, null);
+		const cache = getStorageItem<AssetTemplate[]>(`${schema}.templates.v2`, null);
 		if (cache) {
 			return cache;
 		}
@@ -244,9 +338,14 @@ function Game(): JSX.Element {
 			rarity: t.immutable_data.rarity,
 			shine: t.immutable_data.shine,
 			template_id: t.template_id,
+			race: t.immutable_data.race,
+			element: t.immutable_data.element,
+			weapon_class: t.immutable_data.class,
+			attack: parseInt(t.immutable_data.attack) || 0,
+			defense: parseInt(t.immutable_data.defense) || 0,
 		}));
 
-		setStorageItem<AssetTemplate[]>(`${schema}.templates`, templates, 0);
+		setStorageItem<AssetTemplate[]>(`${schema}.templates.v2`, templates, 0);
 		return templates;
 	};
 
@@ -342,14 +441,14 @@ function Game(): JSX.Element {
 		return assets;
 	};
 
-	const checkUserInfo = async () => {
+	const fetchUserRow = async <T,>(table: string): Promise<T> => {
 		const response = await axios.post(
 			`https://${BLOCKCHAIN.API_ENDPOINT}/v1/chain/get_table_rows`,
 			{
 				json: true,
 				code: BLOCKCHAIN.DAPP_CONTRACT,
 				scope: BLOCKCHAIN.DAPP_CONTRACT,
-				table: "accounts",
+				table,
 				lower_bound: ual.activeUser.accountName,
 				upper_bound: ual.activeUser.accountName,
 				limit: 1,
@@ -357,10 +456,39 @@ function Game(): JSX.Element {
 			{ responseType: "json", headers: { "Content-Type": "application/json;charset=UTF-8" } },
 		);
 
-		const data: { rows: GameUser[] } = response.data;
+		return response.data?.rows[0];
+	};
 
-		setUserInfo(data?.rows[0] || false);
-		setGameBalance((data?.rows.length && parseFloat(data?.rows[0]?.balance?.quantity)) || 0);
+	const checkUserInfo = async () => {
+		const [balance, stats, payout] = await Promise.all([
+			fetchUserRow<UserBalance>("balances"),
+			fetchUserRow<UserStats>("stats"),
+			fetchUserRow<PendingPayout>("payouts"),
+		]);
+
+		// in auto-payout mode the winnings wait in the payouts ledger until they're sent
+		setPendingPayout((payout && parseFloat(payout.quantity)) || 0);
+
+		if (balance) {
+			setUserInfo({ ...balance, ...stats });
+			setGameBalance(parseFloat(balance.balance) || 0);
+			return;
+		}
+
+		// accounts not migrated yet are still in the legacy accounts table
+		const legacy = await fetchUserRow<LegacyGameUser>("accounts");
+
+		setUserInfo(
+			(legacy && {
+				account: legacy.account,
+				balance: legacy.balance.quantity,
+				reserved: `0.0000 ${BLOCKCHAIN.TOKEN_SYMBOL}`,
+				battle_count: legacy.battle_count,
+				win_count: legacy.win_count,
+			}) ||
+				false,
+		);
+		setGameBalance((legacy && parseFloat(legacy.balance.quantity)) || 0);
 	};
 
 	const fetchAccountBalance = async () => {
@@ -27,6 +27,33 @@ export type WindowProps = {
 };
 
 export type GameUser = {
+	account: string;
+	balance: string;
+	reserved: string;
+	battle_count: number;
+	win_count: number;
+};
+
+export type UserBalance = {
+	account: string;
+	balance: string;
+	reserved: string;
+};
+
+export type PendingPayout = {
+	account: string;
+	quantity: string;
+	win_count: number;
+	since: string;
+};
+
+export type UserStats = {
+	account: string;
+	battle_count: number;
+	win_count: number;
+};
+
+export type LegacyGameUser = {
 	account: string;
 	balance: {
 		contract: string;
@@ -64,6 +91,13 @@ export type AssetTemplate = {
 	template_id: number;
 	rarity: string;
 	shine: string;
+
+	// battle stats of the template, used when the game has no config for it
+	race?: string;
+	element?: string;
+	weapon_class?: string;
+	attack?: number;
+	defense?: number;
 };
 
 export type Crew = AssetItem & AssetTemplate & CrewConf;
@@ -76,6 +110,7 @@ export type Arena = {
 		quantity: string;
 	};
 	fee: number;
+	seq: number;
 };
 
 export type QueueEntry = {
@@ -87,6 +122,7 @@ export type QueueEntry = {
 export type UserQueueEntry = {
 	player: string;
 	queues: QueueEntry[];
+	seq: number;
 };
 
 export type Battle = {
@@ -95,4 +131,13 @@ export type Battle = {
 	players: string[];
 	winner: string;
 	timestamp: string;
+	seq: number;
+};
+
+export type FeedHead = {
+	seq: number;
+	arenas_seq: number;
+	queues_seq: number;
+	battles_seq: number;
+	reset_seq: number;
 };
@@ -4,7 +4,7 @@ import { AppCtx, BLOCKCHAIN } from "../constants";
 import { WindowProps } from "../types";
 
 function WalletWindow(props: WindowProps): JSX.Element {
-	const { ual, gameBalance, accountBalance } = useContext(AppCtx);
+	const { ual, gameBalance, pendingPayout, accountBalance } = useContext(AppCtx);
 	const [depositInput, setDepositInput] = useState<number>(0);
 	const [withdrawInput, setWithdrawInput] = useState<number>(0);
 
@@ -106,6 +106,11 @@ function WalletWindow(props: WindowProps): JSX.Element {
 							<span className="balance" onClick={() => setWithdrawInput(gameBalance)}>{`${gameBalance.toLocaleString("en", {
 								maximumFractionDigits: 4,
 							})} ${BLOCKCHAIN.TOKEN_SYMBOL}`}</span>
+							{pendingPayout > 0 && (
+								<span className="pending-payout">{`+ ${pendingPayout.toLocaleString("en", {
+									maximumFractionDigits: 4,
+								})} ${BLOCKCHAIN.TOKEN_SYMBOL} winnings on their way to your wallet`}</span>
+							)}
 							<input
 								className="input"
 								type="number"
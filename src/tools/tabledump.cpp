@@ -0,0 +1,531 @@
+/*
+Offline decoder for the alienrumblex tables.
+
+Reads the balances, stats, battles and queues rows (and the legacy
+accounts rows) straight from a local nodeos state snapshot, or from a
+binary get_table_rows dump ("json": false), and writes them as CSV files
+ready for local aggregation.
+
+The input is memory-mapped and decoded in a single streaming pass, rows of
+other contracts/tables are skipped without being decoded.
+
+Build:
+    g++ -std=c++17 -O2 -o tabledump src/tools/tabledump.cpp
+
+Usage:
+    tabledump snapshot <snapshot.bin> <contract> <output_dir>
+    tabledump rows <table> <get_table_rows.json> <output_dir>
+*/
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+// nodeos snapshot header magic number
+static constexpr uint32_t SNAPSHOT_MAGIC = 0x30510550;
+
+// section size marking the end of the snapshot
+static constexpr uint64_t SNAPSHOT_END_MARKER = UINT64_MAX;
+
+void check(bool condition, const string &message) {
+    if (!condition) {
+        throw runtime_error(message);
+    }
+}
+
+// eosio name encoding
+uint64_t string_to_name(const string_view &str) {
+    auto char_to_value = [](char c) -> uint64_t {
+        if (c == '.') {
+            return 0;
+        } else if (c >= '1' && c <= '5') {
+            return (c - '1') + 1;
+        } else if (c >= 'a' && c <= 'z') {
+            return (c - 'a') + 6;
+        }
+        check(false, string("invalid character in name: ") + c);
+        return 0;
+    };
+
+    check(str.size() <= 13, "name is too long: " + string(str));
+
+    uint64_t value = 0;
+    for (size_t i = 0; i < str.size() && i < 12; i++) {
+        value |= (char_to_value(str[i]) & 0x1F) << (64 - 5 * (i + 1));
+    }
+    if (str.size() == 13) {
+        value |= char_to_value(str[12]) & 0x0F;
+    }
+    return value;
+}
+
+string name_to_string(uint64_t value) {
+    static const char *charmap = ".12345abcdefghijklmnopqrstuvwxyz";
+
+    string str(13, '.');
+    for (int i = 0; i <= 12; i++) {
+        char c = charmap[value & (i == 0 ? 0x0F : 0x1F)];
+        str[12 - i] = c;
+        value >>= (i == 0 ? 4 : 5);
+    }
+
+    // trim the trailing dots
+    auto last = str.find_last_not_of('.');
+    return last == string::npos ? "" : str.substr(0, last + 1);
+}
+
+// reader over a memory region, fails on out of bounds reads
+struct reader {
+    const uint8_t *pos;
+    const uint8_t *end;
+
+    void skip(uint64_t size) {
+        check((uint64_t)(end - pos) >= size, "unexpected end of data");
+        pos += size;
+    }
+
+    template <typename T> T read() {
+        T value;
+        check((size_t)(end - pos) >= sizeof(T), "unexpected end of data");
+        memcpy(&value, pos, sizeof(T));
+        pos += sizeof(T);
+        return value;
+    }
+
+    uint64_t read_varuint() {
+        uint64_t value = 0;
+        uint8_t shift = 0;
+        while (true) {
+            check(shift < 64, "varint is too long");
+            auto byte = read<uint8_t>();
+            value |= (uint64_t)(byte & 0x7F) << shift;
+            shift += 7;
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+    }
+
+    reader read_bytes() {
+        auto size = read_varuint();
+        reader bytes{pos, pos};
+        skip(size);
+        bytes.end = pos;
+        return bytes;
+    }
+
+    string read_cstring() {
+        auto terminator = (const uint8_t *)memchr(pos, 0, end - pos);
+        check(terminator != nullptr, "unterminated string");
+        string str((const char *)pos, terminator - pos);
+        pos = terminator + 1;
+        return str;
+    }
+
+    bool done() const {
+        return pos == end;
+    }
+};
+
+// memory-mapped input file
+struct mapped_file {
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+
+    explicit mapped_file(const string &path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        check(fd >= 0, "unable to open " + path);
+
+        struct stat info;
+        check(fstat(fd, &info) == 0, "unable to stat " + path);
+        size = info.st_size;
+
+        if (size > 0) {
+            auto mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            check(mapped != MAP_FAILED, "unable to map " + path);
+            madvise(mapped, size, MADV_SEQUENTIAL);
+            data = (const uint8_t *)mapped;
+        }
+        close(fd);
+    }
+
+    ~mapped_file() {
+        if (data != nullptr) {
+            munmap((void *)data, size);
+        }
+    }
+
+    reader contents() const {
+        return reader{data, data + size};
+    }
+};
+
+string format_asset(const int64_t &amount, const uint64_t &symbol) {
+    uint8_t precision = symbol & 0xFF;
+
+    // the symbol code is stored in the remaining bytes
+    string code;
+    for (auto raw = symbol >> 8; raw > 0; raw >>= 8) {
+        code += (char)(raw & 0xFF);
+    }
+
+    uint64_t magnitude = amount < 0 ? -(uint64_t)amount : amount;
+    string digits = to_string(magnitude);
+    if (precision > 0) {
+        if (digits.size() <= precision) {
+            digits.insert(0, precision + 1 - digits.size(), '0');
+        }
+        digits.insert(digits.size() - precision, ".");
+    }
+
+    return (amount < 0 ? "-" : "") + digits + " " + code;
+}
+
+string format_time(const uint32_t &seconds) {
+    time_t time = seconds;
+    struct tm utc;
+    gmtime_r(&time, &utc);
+
+    char buffer[32];
+    strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S", &utc);
+    return buffer;
+}
+
+// csv writers of the decoded tables
+// the row layouts mirror the table structs in alienrumblex.hpp
+class table_writer {
+  public:
+    explicit table_writer(const string &output_dir) : output_dir(output_dir) {
+    }
+
+    // decode a single row of the given table, returns false for unknown tables
+    bool write_row(const uint64_t &table, reader row) {
+        if (table == BALANCES) {
+            write_balance(row);
+        } else if (table == STATS) {
+            write_stats(row);
+        } else if (table == ACCOUNTS) {
+            write_account(row);
+        } else if (table == BATTLES) {
+            write_battle(row);
+        } else if (table == QUEUES) {
+            write_queue(row);
+        } else {
+            return false;
+        }
+
+        // leftover bytes mean the layout changed, fail instead of writing wrong values
+        check(row.done(), "unexpected trailing data in a " + name_to_string(table) + " row");
+        return true;
+    }
+
+    uint64_t row_count() const {
+        return rows;
+    }
+
+  private:
+    const uint64_t BALANCES = string_to_name("balances");
+    const uint64_t STATS = string_to_name("stats");
+    const uint64_t ACCOUNTS = string_to_name("accounts");
+    const uint64_t BATTLES = string_to_name("battles");
+    const uint64_t QUEUES = string_to_name("queues");
+
+    string output_dir;
+    ofstream balances, stats, accounts, battles, battle_players, queue_entries;
+    uint64_t rows = 0;
+
+    ofstream &open_csv(ofstream &file, const string &file_name, const string &header) {
+        if (!file.is_open()) {
+            file.open(output_dir + "/" + file_name);
+            check(file.good(), "unable to create " + output_dir + "/" + file_name);
+            file << header << "\n";
+        }
+        return file;
+    }
+
+    // balance_entity
+    void write_balance(reader &row) {
+        auto account = row.read<uint64_t>();
+        auto amount = row.read<int64_t>();
+        auto symbol = row.read<uint64_t>();
+        auto reserved_amount = row.read<int64_t>();
+        auto reserved_symbol = row.read<uint64_t>();
+
+        open_csv(balances, "balances.csv", "account,balance,reserved")
+            << name_to_string(account) << "," << format_asset(amount, symbol) << ","
+            << format_asset(reserved_amount, reserved_symbol) << "\n";
+        ++rows;
+    }
+
+    // stats_entity
+    void write_stats(reader &row) {
+        auto account = row.read<uint64_t>();
+        auto battle_count = row.read<uint64_t>();
+        auto win_count = row.read<uint64_t>();
+
+        open_csv(stats, "stats.csv", "account,battle_count,win_count")
+            << name_to_string(account) << "," << battle_count << "," << win_count << "\n";
+        ++rows;
+    }
+
+    // legacy account_entity, for the accounts not migrated yet
+    void write_account(reader &row) {
+        auto account = row.read<uint64_t>();
+        auto amount = row.read<int64_t>();
+        auto symbol = row.read<uint64_t>();
+        auto contract = row.read<uint64_t>();
+        auto battle_count = row.read<uint64_t>();
+        auto win_count = row.read<uint64_t>();
+
+        open_csv(accounts, "accounts.csv", "account,balance,contract,battle_count,win_count")
+            << name_to_string(account) << "," << format_asset(amount, symbol) << ","
+            << name_to_string(contract) << "," << battle_count << "," << win_count << "\n";
+        ++rows;
+    }
+
+    // battle_entity, the players are written in a separate file, one row per player
+    void write_battle(reader &row) {
+        auto battle_id = row.read<uint64_t>();
+        auto arena_name = row.read<uint64_t>();
+
+        auto player_count = row.read_varuint();
+        open_csv(battle_players, "battle_players.csv", "battle_id,player");
+        for (uint64_t i = 0; i < player_count; i++) {
+            battle_players << battle_id << "," << name_to_string(row.read<uint64_t>()) << "\n";
+        }
+
+        auto winner = row.read<uint64_t>();
+        auto timestamp = row.read<uint32_t>();
+        // rows written before the change feed have no seq
+        auto seq = row.done() ? 0 : row.read<uint64_t>();
+
+        open_csv(battles, "battles.csv", "battle_id,arena_name,player_count,winner,timestamp,seq")
+            << battle_id << "," << name_to_string(arena_name) << "," << player_count << ","
+            << name_to_string(winner) << "," << format_time(timestamp) << "," << seq << "\n";
+        ++rows;
+    }
+
+    // queue_entity, one row per queue entry
+    void write_queue(reader &row) {
+        auto player = row.read<uint64_t>();
+        auto entry_count = row.read_varuint();
+
+        // the seq & reservations fields come after the entries, decode them first
+        vector<uint64_t> entries;
+        entries.reserve(entry_count * 3);
+        for (uint64_t i = 0; i < entry_count * 3; i++) {
+            entries.push_back(row.read<uint64_t>());
+        }
+        auto seq = row.done() ? 0 : row.read<uint64_t>();
+
+        // rows written before the balances migration have no reservations, left empty
+        vector<string> reservations(entry_count);
+        if (!row.done()) {
+            check(row.read_varuint() == entry_count, "queue reservations don't match the entries");
+            for (auto &reserved : reservations) {
+                auto amount = row.read<int64_t>();
+                auto symbol = row.read<uint64_t>();
+                reserved = format_asset(amount, symbol);
+            }
+        }
+
+        open_csv(queue_entries, "queue_entries.csv",
+                 "player,arena_name,minion_id,weapon_id,seq,reserved");
+        for (uint64_t i = 0; i < entry_count; i++) {
+            queue_entries << name_to_string(player) << "," << name_to_string(entries[i * 3])
+                          << "," << entries[i * 3 + 1] << "," << entries[i * 3 + 2] << ","
+                          << seq << "," << reservations[i] << "\n";
+        }
+        ++rows;
+    }
+};
+
+/*
+    Decode the contract tables from a nodeos snapshot
+
+    The contract_tables section holds, for every table, the table_id row
+    followed by the key/value rows and the rows of each secondary index type,
+    each group prefixed by its row count.
+*/
+void decode_snapshot(const reader &snapshot, const uint64_t &contract, table_writer &writer) {
+    reader input = snapshot;
+
+    check(input.read<uint32_t>() == SNAPSHOT_MAGIC, "not a nodeos snapshot");
+    input.read<uint32_t>(); // snapshot version
+
+    // byte size of the rows of each secondary index type:
+    // index64, index128, index256, index_double, index_long_double
+    static constexpr uint64_t SECONDARY_ROW_SIZES[] = {24, 32, 48, 24, 32};
+
+    while (true) {
+        auto section_size = input.read<uint64_t>();
+        if (section_size == SNAPSHOT_END_MARKER) {
+            return;
+        }
+
+        // the section size doesn't include the size field itself
+        reader section{input.pos, input.pos};
+        input.skip(section_size);
+        section.end = input.pos;
+
+        section.read<uint64_t>(); // row count
+        if (section.read_cstring() != "contract_tables") {
+            continue;
+        }
+
+        while (!section.done()) {
+            // table_id row
+            auto code = section.read<uint64_t>();
+            section.read<uint64_t>(); // scope
+            auto table = section.read<uint64_t>();
+            section.read<uint64_t>(); // payer
+            section.read<uint32_t>(); // count
+
+            // key/value rows, only the ones of the contract are decoded
+            auto kv_count = section.read_varuint();
+            for (uint64_t i = 0; i < kv_count; i++) {
+                section.read<uint64_t>(); // primary key
+                section.read<uint64_t>(); // payer
+                auto value = section.read_bytes();
+
+                if (code == contract) {
+                    writer.write_row(table, value);
+                }
+            }
+
+            // secondary index rows are not needed
+            for (auto row_size : SECONDARY_ROW_SIZES) {
+                section.skip(section.read_varuint() * row_size);
+            }
+        }
+
+        return;
+    }
+}
+
+/*
+    Decode the rows of a get_table_rows response fetched with "json": false
+
+    The rows are either hex strings, or objects with a hex "data" field
+    when "show_payer" is set.
+*/
+void decode_rows_dump(const reader &dump, const uint64_t &table, table_writer &writer) {
+    string_view json((const char *)dump.pos, dump.end - dump.pos);
+
+    auto rows_key = json.find("\"rows\"");
+    check(rows_key != string_view::npos, "no rows in the dump");
+    auto pos = json.find('[', rows_key);
+    check(pos != string_view::npos, "no rows in the dump");
+
+    auto hex_value = [](char c) -> uint8_t {
+        if (c >= '0' && c <= '9') {
+            return c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            return c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            return c - 'A' + 10;
+        }
+        check(false, string("invalid hex character: ") + c);
+        return 0;
+    };
+
+    auto read_string = [&]() -> string_view {
+        auto start = pos + 1;
+        auto close = json.find('"', start);
+        check(close != string_view::npos, "unterminated string");
+        pos = close + 1;
+        return json.substr(start, close - start);
+    };
+
+    vector<uint8_t> bytes;
+    auto write_hex_row = [&](const string_view &hex) {
+        check(hex.size() % 2 == 0, "invalid hex row");
+
+        bytes.resize(hex.size() / 2);
+        for (size_t i = 0; i < bytes.size(); i++) {
+            bytes[i] = (hex_value(hex[i * 2]) << 4) | hex_value(hex[i * 2 + 1]);
+        }
+
+        check(writer.write_row(table, reader{bytes.data(), bytes.data() + bytes.size()}),
+              "unsupported table: " + name_to_string(table));
+    };
+
+    ++pos;
+    while (true) {
+        pos = json.find_first_not_of(" \t\r\n,", pos);
+        check(pos != string_view::npos, "unterminated rows");
+
+        if (json[pos] == ']') {
+            return;
+        } else if (json[pos] == '"') {
+            write_hex_row(read_string());
+        } else if (json[pos] == '{') {
+            // object row, look for the data field
+            ++pos;
+            while (true) {
+                pos = json.find_first_not_of(" \t\r\n,", pos);
+                check(pos != string_view::npos, "unterminated row");
+                if (json[pos] == '}') {
+                    ++pos;
+                    break;
+                }
+
+                auto key = read_string();
+                pos = json.find('"', json.find(':', pos));
+                auto value = read_string();
+
+                if (key == "data") {
+                    write_hex_row(value);
+                }
+            }
+        } else {
+            check(false, "unexpected character in rows");
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc != 5) {
+        fprintf(stderr,
+                "usage:\n"
+                "    %s snapshot <snapshot.bin> <contract> <output_dir>\n"
+                "    %s rows <table> <get_table_rows.json> <output_dir>\n",
+                argv[0], argv[0]);
+        return 1;
+    }
+
+    try {
+        string mode = argv[1];
+        table_writer writer(argv[4]);
+
+        if (mode == "snapshot") {
+            mapped_file snapshot(argv[2]);
+            decode_snapshot(snapshot.contents(), string_to_name(argv[3]), writer);
+        } else if (mode == "rows") {
+            mapped_file dump(argv[3]);
+            decode_rows_dump(dump.contents(), string_to_name(argv[2]), writer);
+        } else {
+            check(false, "unknown mode: " + mode);
+        }
+
+        fprintf(stderr, "decoded %llu rows\n", (unsigned long long)writer.row_count());
+    } catch (const exception &e) {
+        fprintf(stderr, "error: %s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}